@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "../harris_corner_detector/harris.hpp"
+#include "ransac.hpp"
+
+// Two ways to run the verification:
+//   Ground truth matches perturbed with random outliers to stress the verification,
+//   e.g. geometric_verification images/NotreDame/921919841_a30df938f2_o_to_4191453057_c86028ce1f_o.mat fundamental 300
+//   Harris corners of two images matched by patch correlation,
+//   e.g. geometric_verification images/NotreDame/921919841_a30df938f2_o.jpg images/NotreDame/4191453057_c86028ce1f_o.jpg
+
+const float k = 0.04;
+const unsigned int min_pixel_radius = 10;
+const int PATCH_RADIUS = 5;
+
+cv::Rect2d bounding_box(const std::vector<ransac::Correspondence> &correspondences, bool left) {
+  cv::Point2d min_point = left ? correspondences[0].left : correspondences[0].right;
+  cv::Point2d max_point = min_point;
+  for (auto correspondence : correspondences) {
+    cv::Point2d p = left ? correspondence.left : correspondence.right;
+    min_point = cv::Point2d(std::min(min_point.x, p.x), std::min(min_point.y, p.y));
+    max_point = cv::Point2d(std::max(max_point.x, p.x), std::max(max_point.y, p.y));
+  }
+  return cv::Rect2d(min_point, max_point);
+}
+
+void add_outliers(std::vector<ransac::Correspondence> &correspondences, unsigned int num_outliers) {
+  cv::RNG rng(12345);
+  cv::Rect2d left_box = bounding_box(correspondences, true);
+  cv::Rect2d right_box = bounding_box(correspondences, false);
+  // Scores overlap so PROSAC ordering helps without giving the answer away
+  for (auto &correspondence : correspondences) {
+    correspondence.score = rng.uniform(0.25, 1.0);
+  }
+  for (unsigned int i = 0; i < num_outliers; ++i) {
+    ransac::Correspondence outlier;
+    outlier.left = cv::Point2d(rng.uniform(left_box.x, left_box.x + left_box.width), rng.uniform(left_box.y, left_box.y + left_box.height));
+    outlier.right = cv::Point2d(rng.uniform(right_box.x, right_box.x + right_box.width), rng.uniform(right_box.y, right_box.y + right_box.height));
+    outlier.score = rng.uniform(0.0, 0.75);
+    correspondences.emplace_back(outlier);
+  }
+}
+
+// Accepts plain non-negative integers only; at most 9 digits so the value always fits
+bool parse_count(const std::string &text, unsigned int &count) {
+  if (text.empty() || text.size() > 9 || !std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+    return false;
+  }
+  count = static_cast<unsigned int>(std::stoul(text));
+  return true;
+}
+
+std::vector<harris::InterestPoint> detect_interest_points(const cv::Mat &image) {
+  cv::Mat interest_points = harris::get_interest_points(image, 7, k);
+  return harris::suppress_nonmax(interest_points, 10, min_pixel_radius);
+}
+
+// Zero mean, unit norm patches around the interest points, one per row, so a single matrix product
+// gives the normalized cross correlation of every pair. Points too close to the border are dropped.
+cv::Mat normalized_patches(const cv::Mat &image, std::vector<harris::InterestPoint> &interest_points) {
+  cv::Mat image_gray;
+  cvtColor(image, image_gray, cv::COLOR_BGR2GRAY);
+  image_gray.convertTo(image_gray, CV_32F);
+
+  int side = 2 * PATCH_RADIUS + 1;
+  cv::Rect bounds(0, 0, image_gray.cols, image_gray.rows);
+  std::vector<harris::InterestPoint> kept_points;
+  cv::Mat patches(0, side * side, CV_32F);
+  for (auto interest_point : interest_points) {
+    cv::Rect window(interest_point.point.x - PATCH_RADIUS, interest_point.point.y - PATCH_RADIUS, side, side);
+    if ((window & bounds) != window) {
+      continue;
+    }
+    cv::Mat patch = image_gray(window).clone().reshape(1, 1);
+    patch -= cv::mean(patch)[0];
+    double norm = cv::norm(patch);
+    if (norm < 1e-6) {
+      continue;
+    }
+    patches.push_back(cv::Mat(patch / norm));
+    kept_points.emplace_back(interest_point);
+  }
+  interest_points.swap(kept_points);
+  return patches;
+}
+
+// Keeps mutual best matches, scored by their normalized cross correlation
+void match_interest_points(const cv::Mat &left_image, const cv::Mat &right_image, std::vector<harris::InterestPoint> &left, std::vector<harris::InterestPoint> &right, std::vector<double> &scores) {
+  std::vector<harris::InterestPoint> left_points = detect_interest_points(left_image);
+  std::vector<harris::InterestPoint> right_points = detect_interest_points(right_image);
+  cv::Mat left_patches = normalized_patches(left_image, left_points);
+  cv::Mat right_patches = normalized_patches(right_image, right_points);
+  if (left_patches.empty() || right_patches.empty()) {
+    return;
+  }
+
+  cv::Mat similarity = left_patches * right_patches.t();
+  std::vector<int> best_left(similarity.cols);
+  for (int col = 0; col < similarity.cols; ++col) {
+    cv::Point best;
+    cv::minMaxLoc(similarity.col(col), nullptr, nullptr, nullptr, &best);
+    best_left[col] = best.y;
+  }
+  for (int row = 0; row < similarity.rows; ++row) {
+    double best_value;
+    cv::Point best;
+    cv::minMaxLoc(similarity.row(row), nullptr, &best_value, nullptr, &best);
+    if (best_left[best.x] == row) {
+      left.emplace_back(left_points[row]);
+      right.emplace_back(right_points[best.x]);
+      scores.emplace_back(best_value);
+    }
+  }
+}
+
+ransac::Parameters model_parameters(int argc, char **argv, int model_argument, double fundamental_threshold) {
+  ransac::Parameters parameters;
+  if (argc > model_argument && std::string(argv[model_argument]) == "homography") {
+    parameters.model = ransac::Model::HOMOGRAPHY;
+    // Wide-baseline scenes are not planar, so only allow a loose fit
+    parameters.inlier_threshold = 10.0;
+  } else {
+    parameters.inlier_threshold = fundamental_threshold;
+  }
+  return parameters;
+}
+
+ransac::Result timed_verify(const std::vector<ransac::Correspondence> &correspondences, const ransac::Parameters &parameters) {
+  std::cout << "Verifying " << correspondences.size() << " correspondences..." << std::endl;
+  cv::TickMeter timer;
+  timer.start();
+  ransac::Result result = ransac::verify(correspondences, parameters);
+  timer.stop();
+
+  std::cout << "Model:" << std::endl << result.model << std::endl;
+  std::cout << "Inliers: " << result.num_inliers << std::endl;
+  std::cout << "Iterations: " << result.iterations << std::endl;
+  std::cout << "Time: " << timer.getTimeMilli() << " ms" << std::endl;
+  return result;
+}
+
+bool is_model_name(const std::string &name) {
+  return name == "fundamental" || name == "homography";
+}
+
+bool is_mat_file(const std::string &path) {
+  return path.size() > 4 && path.compare(path.size() - 4, 4, ".mat") == 0;
+}
+
+int verify_images(int argc, char **argv) {
+  cv::Mat images[2];
+  for (int i = 0; i < 2; ++i) {
+    cv::Mat image = cv::imread(argv[1 + i], cv::IMREAD_COLOR);
+    if (!image.data) {
+      std::cout << "Could not open file or find the image: " << argv[1 + i] << std::endl;
+      return -1;
+    }
+    // Reduce image size to reduce number of calculations required
+    double scale_factor = 0.5;
+    cv::resize(image, images[i], cv::Size(image.cols * scale_factor, image.rows * scale_factor));
+  }
+
+  std::cout << "Matching interest points..." << std::endl;
+  std::vector<harris::InterestPoint> left, right;
+  std::vector<double> scores;
+  match_interest_points(images[0], images[1], left, right, scores);
+  std::vector<ransac::Correspondence> correspondences = ransac::make_correspondences(left, right, scores);
+
+  // Corners sit on the integer pixel grid of the scaled down images
+  timed_verify(correspondences, model_parameters(argc, argv, 3, 2.0));
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned int num_outliers = 0;
+  bool ground_truth = argc > 1 && is_mat_file(argv[1]);
+  // The model name follows the .mat file, or the two images
+  int model_argument = ground_truth ? 2 : 3;
+  if (argc < 2 || argc > 4 ||
+      (!ground_truth && argc < 3) ||
+      (argc > model_argument && !is_model_name(argv[model_argument])) ||
+      (ground_truth && argc > 3 && !parse_count(argv[3], num_outliers))) {
+    std::cout << "Usage: geometric_verification <ground_truth.mat> [fundamental|homography] [num_outliers]" << std::endl;
+    std::cout << "       geometric_verification <left_image> <right_image> [fundamental|homography]" << std::endl;
+    return -1;
+  }
+  if (!ground_truth) {
+    return verify_images(argc, argv);
+  }
+
+  std::vector<ransac::Correspondence> correspondences = ransac::load_ground_truth(argv[1]);
+  if (correspondences.empty()) {
+    return -1;
+  }
+  size_t num_ground_truth = correspondences.size();
+  if (argc > 3) {
+    add_outliers(correspondences, num_outliers);
+  }
+
+  // The ground truth points were clicked by hand
+  ransac::Result result = timed_verify(correspondences, model_parameters(argc, argv, 2, 3.0));
+  size_t ground_truth_inliers = 0;
+  for (size_t i = 0; i < num_ground_truth; ++i) {
+    ground_truth_inliers += result.inlier_mask[i];
+  }
+  std::cout << "Ground truth inliers: " << ground_truth_inliers << " of " << num_ground_truth << std::endl;
+  return 0;
+}
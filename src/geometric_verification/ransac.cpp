@@ -0,0 +1,652 @@
+#include "ransac.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <numeric>
+
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/core/utility.hpp>
+#include <zlib.h>
+
+// MAT-file v5 data types, see "MAT-File Format" in the MATLAB documentation
+const uint32_t MI_INT8 = 1;
+const uint32_t MI_MATRIX = 14;
+const uint32_t MI_COMPRESSED = 15;
+const size_t MAT_HEADER_SIZE = 128;
+
+// Number of correspondences scored between checks for an early exit
+const int SCORING_BLOCK_SIZE = 256;
+// Probability that an outlier supports a wrong model, and how unlikely random support has to be before
+// PROSAC trusts it to stop early (NON_RANDOMNESS_QUANTILE is the matching standard normal quantile)
+const double RANDOM_INLIER_PROBABILITY = 0.05;
+const double NON_RANDOM_PROBABILITY = 0.05;
+const double NON_RANDOMNESS_QUANTILE = 1.645;
+const int EXACT_BINOMIAL_TRIALS = 200;
+
+struct MatElement {
+  uint32_t type;
+  uint32_t size;
+  const uchar *data;
+};
+
+bool read_mat_element(const std::vector<uchar> &buffer, size_t &offset, MatElement &element) {
+  if (offset + 8 > buffer.size()) {
+    return false;
+  }
+  uint32_t tag[2];
+  std::memcpy(tag, &buffer[offset], sizeof(tag));
+  // Small data elements pack their size into the upper half of the type and their data into the tag
+  if (tag[0] >> 16) {
+    element.type = tag[0] & 0xffff;
+    element.size = tag[0] >> 16;
+    element.data = buffer.data() + offset + 4;
+    offset += 8;
+    return element.size <= 4;
+  }
+  element.type = tag[0];
+  element.size = tag[1];
+  if (offset + 8 + element.size > buffer.size()) {
+    return false;
+  }
+  element.data = buffer.data() + offset + 8;
+  // Compressed elements are not padded, everything else is aligned to 8 bytes
+  offset += 8 + (element.type == MI_COMPRESSED ? element.size : (element.size + 7) / 8 * 8);
+  return true;
+}
+
+bool inflate_mat_element(const MatElement &element, std::vector<uchar> &inflated) {
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  if (inflateInit(&stream) != Z_OK) {
+    return false;
+  }
+  stream.next_in = const_cast<Bytef *>(element.data);
+  stream.avail_in = element.size;
+
+  inflated.resize(std::max<size_t>(static_cast<size_t>(element.size) * 4, 1024));
+  int status = Z_OK;
+  while (status == Z_OK) {
+    if (stream.total_out == inflated.size()) {
+      inflated.resize(inflated.size() * 2);
+    }
+    stream.next_out = &inflated[stream.total_out];
+    stream.avail_out = static_cast<uInt>(inflated.size() - stream.total_out);
+    status = inflate(&stream, Z_NO_FLUSH);
+  }
+  inflated.resize(stream.total_out);
+  inflateEnd(&stream);
+  return status == Z_STREAM_END;
+}
+
+double read_mat_number(const uchar *data, uint32_t type) {
+  switch (type) {
+    case 1: { int8_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+    case 2: { uint8_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+    case 3: { int16_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+    case 4: { uint16_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+    case 5: { int32_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+    case 6: { uint32_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+    case 7: { float v; std::memcpy(&v, data, sizeof(v)); return v; }
+    case 9: { double v; std::memcpy(&v, data, sizeof(v)); return v; }
+    case 12: { int64_t v; std::memcpy(&v, data, sizeof(v)); return static_cast<double>(v); }
+    case 13: { uint64_t v; std::memcpy(&v, data, sizeof(v)); return static_cast<double>(v); }
+  }
+  return 0;
+}
+
+size_t mat_type_size(uint32_t type) {
+  switch (type) {
+    case 1: case 2: return 1;
+    case 3: case 4: return 2;
+    case 5: case 6: case 7: return 4;
+    case 9: case 12: case 13: return 8;
+  }
+  return 0;
+}
+
+// Reads a real numeric miMATRIX element as a flat vector in column-major order
+bool read_mat_matrix(const MatElement &matrix, std::string &name, std::vector<double> &values) {
+  std::vector<uchar> buffer(matrix.data, matrix.data + matrix.size);
+  size_t offset = 0;
+  MatElement flags, dimensions, array_name, real_part;
+  if (!read_mat_element(buffer, offset, flags) ||
+      !read_mat_element(buffer, offset, dimensions) ||
+      !read_mat_element(buffer, offset, array_name) ||
+      !read_mat_element(buffer, offset, real_part)) {
+    return false;
+  }
+  // Bit 11 of the array flags marks complex data
+  uint32_t array_flags;
+  std::memcpy(&array_flags, flags.data, sizeof(array_flags));
+  if (array_name.type != MI_INT8 || (array_flags & 0x800)) {
+    return false;
+  }
+  size_t element_size = mat_type_size(real_part.type);
+  if (element_size == 0) {
+    return false;
+  }
+  name.assign(reinterpret_cast<const char *>(array_name.data), array_name.size);
+  values.resize(real_part.size / element_size);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = read_mat_number(real_part.data + i * element_size, real_part.type);
+  }
+  return true;
+}
+
+std::vector<ransac::Correspondence> ransac::make_correspondences(const std::vector<harris::InterestPoint> &left, const std::vector<harris::InterestPoint> &right, const std::vector<double> &scores) {
+  std::vector<ransac::Correspondence> correspondences;
+  if (left.size() != right.size() || left.size() != scores.size()) {
+    std::cout << "Mismatched correspondences: " << left.size() << " left points, " << right.size() << " right points, " << scores.size() << " scores" << std::endl;
+    return correspondences;
+  }
+  correspondences.reserve(left.size());
+  for (size_t i = 0; i < left.size(); ++i) {
+    ransac::Correspondence correspondence;
+    correspondence.left = cv::Point2d(left[i].point.x, left[i].point.y);
+    correspondence.right = cv::Point2d(right[i].point.x, right[i].point.y);
+    correspondence.score = scores[i];
+    correspondences.emplace_back(correspondence);
+  }
+  return correspondences;
+}
+
+std::vector<ransac::Correspondence> ransac::load_ground_truth(const std::string &mat_path) {
+  std::vector<ransac::Correspondence> correspondences;
+  std::ifstream file(mat_path, std::ios::binary);
+  std::vector<uchar> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  // Only little-endian files ("IM" endian indicator) are supported
+  if (buffer.size() < MAT_HEADER_SIZE || buffer[126] != 'I' || buffer[127] != 'M') {
+    std::cout << "Not a little-endian MAT-file v5: " << mat_path << std::endl;
+    return correspondences;
+  }
+
+  std::map<std::string, std::vector<double>> variables;
+  size_t offset = MAT_HEADER_SIZE;
+  MatElement element;
+  while (read_mat_element(buffer, offset, element)) {
+    std::vector<uchar> inflated;
+    if (element.type == MI_COMPRESSED) {
+      size_t inflated_offset = 0;
+      if (!inflate_mat_element(element, inflated) || !read_mat_element(inflated, inflated_offset, element)) {
+        continue;
+      }
+    }
+    std::string name;
+    std::vector<double> values;
+    if (element.type == MI_MATRIX && read_mat_matrix(element, name, values)) {
+      variables[name] = values;
+    }
+  }
+
+  const std::vector<double> &x1 = variables["x1"], &y1 = variables["y1"];
+  const std::vector<double> &x2 = variables["x2"], &y2 = variables["y2"];
+  if (x1.empty() || x1.size() != y1.size() || x1.size() != x2.size() || x1.size() != y2.size()) {
+    std::cout << "Could not find matching x1, y1, x2, y2 vectors in: " << mat_path << std::endl;
+    return correspondences;
+  }
+  for (size_t i = 0; i < x1.size(); ++i) {
+    ransac::Correspondence correspondence;
+    // MATLAB pixel coordinates start at 1
+    correspondence.left = cv::Point2d(x1[i] - 1, y1[i] - 1);
+    correspondence.right = cv::Point2d(x2[i] - 1, y2[i] - 1);
+    correspondence.score = 1;
+    correspondences.emplace_back(correspondence);
+  }
+  return correspondences;
+}
+
+// Structure of arrays so the residual loops load consecutive correspondences into SIMD registers
+struct PointSet {
+  std::vector<double> x1, y1, x2, y2;
+};
+
+// Similarity transform moving the centroid to the origin with a mean distance of sqrt(2) (Hartley)
+bool normalizing_transform(const std::vector<double> &xs, const std::vector<double> &ys, const int *indices, int count, cv::Matx33d &T) {
+  double cx = 0, cy = 0;
+  for (int i = 0; i < count; ++i) {
+    cx += xs[indices[i]];
+    cy += ys[indices[i]];
+  }
+  cx /= count;
+  cy /= count;
+  double mean_distance = 0;
+  for (int i = 0; i < count; ++i) {
+    mean_distance += std::hypot(xs[indices[i]] - cx, ys[indices[i]] - cy);
+  }
+  mean_distance /= count;
+  if (mean_distance < 1e-9) {
+    return false;
+  }
+  double s = std::sqrt(2.0) / mean_distance;
+  T = cv::Matx33d(s, 0, -s * cx,
+                  0, s, -s * cy,
+                  0, 0, 1);
+  return true;
+}
+
+bool estimate_fundamental(const PointSet &points, const int *indices, int count, cv::Matx33d &F) {
+  cv::Matx33d T1, T2;
+  if (!normalizing_transform(points.x1, points.y1, indices, count, T1) ||
+      !normalizing_transform(points.x2, points.y2, indices, count, T2)) {
+    return false;
+  }
+  // Each correspondence contributes x2^T F x1 = 0
+  cv::Mat A(count, 9, CV_64F);
+  for (int i = 0; i < count; ++i) {
+    int j = indices[i];
+    double x1 = T1(0, 0) * points.x1[j] + T1(0, 2), y1 = T1(1, 1) * points.y1[j] + T1(1, 2);
+    double x2 = T2(0, 0) * points.x2[j] + T2(0, 2), y2 = T2(1, 1) * points.y2[j] + T2(1, 2);
+    double *row = A.ptr<double>(i);
+    row[0] = x2 * x1; row[1] = x2 * y1; row[2] = x2;
+    row[3] = y2 * x1; row[4] = y2 * y1; row[5] = y2;
+    row[6] = x1;      row[7] = y1;      row[8] = 1;
+  }
+  cv::Mat f;
+  cv::SVD::solveZ(A, f);
+
+  // Enforce rank 2 by zeroing the smallest singular value
+  cv::SVD svd(f.reshape(1, 3));
+  svd.w.at<double>(2) = 0;
+  cv::Mat rank2 = svd.u * cv::Mat::diag(svd.w) * svd.vt;
+
+  F = T2.t() * cv::Matx33d(rank2.ptr<double>()) * T1;
+  double norm = cv::norm(F);
+  if (!std::isfinite(norm) || norm < 1e-12) {
+    return false;
+  }
+  F *= 1.0 / norm;
+  return true;
+}
+
+bool estimate_homography(const PointSet &points, const int *indices, int count, cv::Matx33d &H) {
+  cv::Matx33d T1, T2;
+  if (!normalizing_transform(points.x1, points.y1, indices, count, T1) ||
+      !normalizing_transform(points.x2, points.y2, indices, count, T2)) {
+    return false;
+  }
+  // Each correspondence contributes two rows of x2 x (H x1) = 0
+  cv::Mat A(2 * count, 9, CV_64F);
+  for (int i = 0; i < count; ++i) {
+    int j = indices[i];
+    double x1 = T1(0, 0) * points.x1[j] + T1(0, 2), y1 = T1(1, 1) * points.y1[j] + T1(1, 2);
+    double x2 = T2(0, 0) * points.x2[j] + T2(0, 2), y2 = T2(1, 1) * points.y2[j] + T2(1, 2);
+    double *row = A.ptr<double>(2 * i);
+    row[0] = 0;  row[1] = 0;  row[2] = 0;
+    row[3] = -x1; row[4] = -y1; row[5] = -1;
+    row[6] = y2 * x1; row[7] = y2 * y1; row[8] = y2;
+    row = A.ptr<double>(2 * i + 1);
+    row[0] = x1; row[1] = y1; row[2] = 1;
+    row[3] = 0;  row[4] = 0;  row[5] = 0;
+    row[6] = -x2 * x1; row[7] = -x2 * y1; row[8] = -x2;
+  }
+  cv::Mat h;
+  cv::SVD::solveZ(A, h);
+
+  H = T2.inv() * cv::Matx33d(h.ptr<double>()) * T1;
+  if (!std::isfinite(H(2, 2)) || std::abs(H(2, 2)) < 1e-12) {
+    return false;
+  }
+  H *= 1.0 / H(2, 2);
+  return true;
+}
+
+bool estimate_model(ransac::Model model, const PointSet &points, const int *indices, int count, cv::Matx33d &M) {
+  if (model == ransac::Model::FUNDAMENTAL) {
+    return estimate_fundamental(points, indices, count, M);
+  }
+  return estimate_homography(points, indices, count, M);
+}
+
+// First-order geometric distance to the epipolar constraint (Sampson error). Compared as
+// e^2 < t^2 * denominator to avoid the division, in the scalar and the SIMD form alike.
+struct SampsonError {
+  static bool is_inlier(const cv::Matx33d &F, double x1, double y1, double x2, double y2, double threshold2) {
+    double fx0 = F(0, 0) * x1 + F(0, 1) * y1 + F(0, 2);
+    double fx1 = F(1, 0) * x1 + F(1, 1) * y1 + F(1, 2);
+    double fx2 = F(2, 0) * x1 + F(2, 1) * y1 + F(2, 2);
+    double ftx0 = F(0, 0) * x2 + F(1, 0) * y2 + F(2, 0);
+    double ftx1 = F(0, 1) * x2 + F(1, 1) * y2 + F(2, 1);
+    double e = x2 * fx0 + y2 * fx1 + fx2;
+    return e * e < threshold2 * (fx0 * fx0 + fx1 * fx1 + ftx0 * ftx0 + ftx1 * ftx1);
+  }
+
+#if CV_SIMD128_64F
+  // Tests two correspondences at a time with the 128-bit universal intrinsics
+  struct Pairs {
+    cv::v_float64x2 f00, f01, f02, f10, f11, f12, f20, f21, f22, t2;
+
+    Pairs(const cv::Matx33d &F, double threshold2)
+      : f00(cv::v_setall_f64(F(0, 0))), f01(cv::v_setall_f64(F(0, 1))), f02(cv::v_setall_f64(F(0, 2))),
+        f10(cv::v_setall_f64(F(1, 0))), f11(cv::v_setall_f64(F(1, 1))), f12(cv::v_setall_f64(F(1, 2))),
+        f20(cv::v_setall_f64(F(2, 0))), f21(cv::v_setall_f64(F(2, 1))), f22(cv::v_setall_f64(F(2, 2))),
+        t2(cv::v_setall_f64(threshold2)) {}
+
+    // Bit 0 is set if correspondence i is an inlier, bit 1 for correspondence i + 1
+    int inliers(const PointSet &points, int i) const {
+      cv::v_float64x2 x1 = cv::v_load(&points.x1[i]), y1 = cv::v_load(&points.y1[i]);
+      cv::v_float64x2 x2 = cv::v_load(&points.x2[i]), y2 = cv::v_load(&points.y2[i]);
+      cv::v_float64x2 fx0 = cv::v_muladd(f00, x1, cv::v_muladd(f01, y1, f02));
+      cv::v_float64x2 fx1 = cv::v_muladd(f10, x1, cv::v_muladd(f11, y1, f12));
+      cv::v_float64x2 fx2 = cv::v_muladd(f20, x1, cv::v_muladd(f21, y1, f22));
+      cv::v_float64x2 ftx0 = cv::v_muladd(f00, x2, cv::v_muladd(f10, y2, f20));
+      cv::v_float64x2 ftx1 = cv::v_muladd(f01, x2, cv::v_muladd(f11, y2, f21));
+      cv::v_float64x2 e = cv::v_muladd(x2, fx0, cv::v_muladd(y2, fx1, fx2));
+      cv::v_float64x2 denominator = fx0 * fx0 + fx1 * fx1 + ftx0 * ftx0 + ftx1 * ftx1;
+      return cv::v_signmask(e * e < t2 * denominator);
+    }
+  };
+#endif
+};
+
+// Distance between H x1 and x2 in the right image (transfer error). Compared after scaling by w^2
+// to avoid the division, in the scalar and the SIMD form alike.
+struct TransferError {
+  static bool is_inlier(const cv::Matx33d &H, double x1, double y1, double x2, double y2, double threshold2) {
+    double w = H(2, 0) * x1 + H(2, 1) * y1 + H(2, 2);
+    double dx = H(0, 0) * x1 + H(0, 1) * y1 + H(0, 2) - x2 * w;
+    double dy = H(1, 0) * x1 + H(1, 1) * y1 + H(1, 2) - y2 * w;
+    return dx * dx + dy * dy < threshold2 * (w * w);
+  }
+
+#if CV_SIMD128_64F
+  // Tests two correspondences at a time with the 128-bit universal intrinsics
+  struct Pairs {
+    cv::v_float64x2 h00, h01, h02, h10, h11, h12, h20, h21, h22, t2;
+
+    Pairs(const cv::Matx33d &H, double threshold2)
+      : h00(cv::v_setall_f64(H(0, 0))), h01(cv::v_setall_f64(H(0, 1))), h02(cv::v_setall_f64(H(0, 2))),
+        h10(cv::v_setall_f64(H(1, 0))), h11(cv::v_setall_f64(H(1, 1))), h12(cv::v_setall_f64(H(1, 2))),
+        h20(cv::v_setall_f64(H(2, 0))), h21(cv::v_setall_f64(H(2, 1))), h22(cv::v_setall_f64(H(2, 2))),
+        t2(cv::v_setall_f64(threshold2)) {}
+
+    // Bit 0 is set if correspondence i is an inlier, bit 1 for correspondence i + 1
+    int inliers(const PointSet &points, int i) const {
+      cv::v_float64x2 x1 = cv::v_load(&points.x1[i]), y1 = cv::v_load(&points.y1[i]);
+      cv::v_float64x2 x2 = cv::v_load(&points.x2[i]), y2 = cv::v_load(&points.y2[i]);
+      cv::v_float64x2 w = cv::v_muladd(h20, x1, cv::v_muladd(h21, y1, h22));
+      cv::v_float64x2 dx = cv::v_muladd(h00, x1, cv::v_muladd(h01, y1, h02)) - x2 * w;
+      cv::v_float64x2 dy = cv::v_muladd(h10, x1, cv::v_muladd(h11, y1, h12)) - y2 * w;
+      return cv::v_signmask(dx * dx + dy * dy < t2 * (w * w));
+    }
+  };
+#endif
+};
+
+// count_inliers and find_inliers must agree on every correspondence, so both test pairs starting at even
+// indices with Error::Pairs and leave only an odd last correspondence to Error::is_inlier.
+// SCORING_BLOCK_SIZE is even to keep the blocks of count_inliers on that pairing.
+
+// Counts inliers block by block and gives up as soon as the hypothesis can no longer beat count_to_beat
+template <typename Error>
+int count_inliers(const PointSet &points, const cv::Matx33d &M, double threshold2, int count_to_beat) {
+  int n = static_cast<int>(points.x1.size());
+#if CV_SIMD128_64F
+  const typename Error::Pairs pairs(M, threshold2);
+#endif
+  int inliers = 0;
+  for (int start = 0; start < n; start += SCORING_BLOCK_SIZE) {
+    int end = std::min(start + SCORING_BLOCK_SIZE, n);
+    int i = start;
+    int block_inliers = 0;
+#if CV_SIMD128_64F
+    for (; i + 2 <= end; i += 2) {
+      int mask = pairs.inliers(points, i);
+      block_inliers += (mask & 1) + (mask >> 1);
+    }
+#endif
+    for (; i < end; ++i) {
+      block_inliers += Error::is_inlier(M, points.x1[i], points.y1[i], points.x2[i], points.y2[i], threshold2);
+    }
+    inliers += block_inliers;
+    if (inliers + (n - end) <= count_to_beat) {
+      break;
+    }
+  }
+  return inliers;
+}
+
+template <typename Error>
+std::vector<int> find_inliers(const PointSet &points, const cv::Matx33d &M, double threshold2) {
+  int n = static_cast<int>(points.x1.size());
+  std::vector<int> inliers;
+  int i = 0;
+#if CV_SIMD128_64F
+  const typename Error::Pairs pairs(M, threshold2);
+  for (; i + 2 <= n; i += 2) {
+    int mask = pairs.inliers(points, i);
+    if (mask & 1) {
+      inliers.emplace_back(i);
+    }
+    if (mask & 2) {
+      inliers.emplace_back(i + 1);
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if (Error::is_inlier(M, points.x1[i], points.y1[i], points.x2[i], points.y2[i], threshold2)) {
+      inliers.emplace_back(i);
+    }
+  }
+  return inliers;
+}
+
+int count_inliers(ransac::Model model, const PointSet &points, const cv::Matx33d &M, double threshold2, int count_to_beat) {
+  if (model == ransac::Model::FUNDAMENTAL) {
+    return count_inliers<SampsonError>(points, M, threshold2, count_to_beat);
+  }
+  return count_inliers<TransferError>(points, M, threshold2, count_to_beat);
+}
+
+std::vector<int> find_inliers(ransac::Model model, const PointSet &points, const cv::Matx33d &M, double threshold2) {
+  if (model == ransac::Model::FUNDAMENTAL) {
+    return find_inliers<SampsonError>(points, M, threshold2);
+  }
+  return find_inliers<TransferError>(points, M, threshold2);
+}
+
+// PROSAC (Chum & Matas, 2005): samples are drawn from a subset of the best scored correspondences
+// which grows towards the full set. All correspondences are in the subset after max_iterations
+// hypotheses at the latest.
+class ProsacSampler {
+public:
+  ProsacSampler(int num_points, int sample_size, unsigned int max_iterations)
+    : num_points(num_points), sample_size(sample_size), subset_size(sample_size), t(0), t_max(max_iterations), t_n_prime(1),
+      grown_at(num_points + 1, 0) {
+    t_n = max_iterations;
+    for (int i = 0; i < sample_size; ++i) {
+      t_n *= static_cast<double>(subset_size - i) / (num_points - i);
+    }
+  }
+
+  void sample(cv::RNG &rng, int *indices) {
+    ++t;
+    // The PROSAC schedule adds at most one correspondence per hypothesis, so the subset also grows at
+    // least linearly to cover more correspondences than there are hypotheses
+    double linear_size = sample_size + std::ceil((num_points - sample_size) * std::min(t / t_max, 1.0));
+    while (subset_size < num_points && (t > t_n_prime || subset_size < linear_size)) {
+      double t_next = t_n * (subset_size + 1) / (subset_size + 1 - sample_size);
+      t_n_prime += std::ceil(t_next - t_n);
+      t_n = t_next;
+      grown_at[subset_size++] = static_cast<unsigned int>(t);
+    }
+    // Until the schedule catches up, the newest correspondence is always part of the sample
+    int random_count = sample_size;
+    int random_range = subset_size;
+    if (t <= t_n_prime) {
+      indices[--random_count] = subset_size - 1;
+      --random_range;
+    }
+    for (int i = 0; i < random_count; ++i) {
+      int index;
+      do {
+        index = rng.uniform(0, random_range);
+      } while (std::find(indices, indices + i, index) != indices + i);
+      indices[i] = index;
+    }
+  }
+
+  // Number of hypotheses so far whose sample was drawn from the top n correspondences
+  unsigned int samples_within(int n) const {
+    return n >= subset_size ? static_cast<unsigned int>(t) : grown_at[n] - 1;
+  }
+
+private:
+  int num_points;
+  int sample_size;
+  int subset_size;
+  double t;
+  double t_max;
+  double t_n;
+  double t_n_prime;
+  // Hypothesis at which the subset first grew beyond n correspondences
+  std::vector<unsigned int> grown_at;
+};
+
+unsigned int required_iterations(int num_inliers, int num_points, int sample_size, double confidence, unsigned int max_iterations) {
+  double p_all_inliers = std::pow(static_cast<double>(num_inliers) / num_points, sample_size);
+  if (p_all_inliers >= 1) {
+    return 1;
+  }
+  if (p_all_inliers <= std::numeric_limits<double>::epsilon()) {
+    return max_iterations;
+  }
+  double iterations = std::ceil(std::log(1 - confidence) / std::log(1 - p_all_inliers));
+  return static_cast<unsigned int>(std::min<double>(iterations, max_iterations));
+}
+
+// Smallest support of a model estimated from subset_size correspondences that a random model reaches
+// with probability below NON_RANDOM_PROBABILITY. Besides its own sample, a random model is supported by
+// Binomial(subset_size - sample_size, RANDOM_INLIER_PROBABILITY) correspondences.
+double minimum_non_random_support(int subset_size, int sample_size) {
+  int trials = subset_size - sample_size;
+  double p = RANDOM_INLIER_PROBABILITY;
+  if (trials > EXACT_BINOMIAL_TRIALS) {
+    // The normal approximation is accurate once the expected random support is large enough
+    double mean = trials * p;
+    return sample_size + mean + NON_RANDOMNESS_QUANTILE * std::sqrt(mean * (1 - p));
+  }
+  double probability = std::pow(1 - p, trials);
+  double tail = 1 - probability;
+  int support = 0;
+  while (tail >= NON_RANDOM_PROBABILITY && support < trials) {
+    probability *= (trials - support) / (support + 1.0) * p / (1 - p);
+    tail -= probability;
+    ++support;
+  }
+  return sample_size + support + 1;
+}
+
+// PROSAC stopping criterion: for a subset of top scored correspondences where the best model has more
+// support than a random model could have, enough hypotheses drawn from that subset make it unlikely a
+// better model was missed. Returns the subset sizes with the number of hypotheses each one needs.
+// sorted_inliers holds the inlier indices of the best model in ascending (score) order.
+std::vector<std::pair<int, unsigned int>> prosac_stopping_bounds(const std::vector<int> &sorted_inliers, int num_points, int sample_size, double confidence, unsigned int max_iterations) {
+  std::vector<std::pair<int, unsigned int>> bounds;
+  size_t inliers_in_subset = 0;
+  for (int subset_size = sample_size; subset_size <= num_points; ++subset_size) {
+    while (inliers_in_subset < sorted_inliers.size() && sorted_inliers[inliers_in_subset] < subset_size) {
+      ++inliers_in_subset;
+    }
+    if (inliers_in_subset < minimum_non_random_support(subset_size, sample_size)) {
+      continue;
+    }
+    bounds.emplace_back(subset_size, required_iterations(static_cast<int>(inliers_in_subset), subset_size, sample_size, confidence, max_iterations));
+  }
+  return bounds;
+}
+
+ransac::Result ransac::verify(const std::vector<ransac::Correspondence> &correspondences, const ransac::Parameters &parameters) {
+  ransac::Result result;
+  const int num_points = static_cast<int>(correspondences.size());
+  const int sample_size = parameters.model == ransac::Model::FUNDAMENTAL ? 8 : 4;
+  const double threshold2 = parameters.inlier_threshold * parameters.inlier_threshold;
+  result.inlier_mask.assign(num_points, 0);
+  if (num_points < sample_size || parameters.max_iterations == 0) {
+    return result;
+  }
+
+  // Everything below works on the correspondences sorted by descending score
+  std::vector<int> order(num_points);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int i1, int i2) { return correspondences[i1].score > correspondences[i2].score; });
+  PointSet points;
+  for (int index : order) {
+    points.x1.emplace_back(correspondences[index].left.x);
+    points.y1.emplace_back(correspondences[index].left.y);
+    points.x2.emplace_back(correspondences[index].right.x);
+    points.y2.emplace_back(correspondences[index].right.y);
+  }
+
+  ProsacSampler sampler(num_points, sample_size, parameters.max_iterations);
+  cv::RNG rng(0xffffffff);
+  const int batch_size = static_cast<int>(std::max(parameters.batch_size, 1u));
+  std::vector<int> samples(batch_size * sample_size);
+  std::vector<cv::Matx33d> hypotheses(batch_size);
+  std::vector<int> scores(batch_size);
+
+  cv::Matx33d best_model;
+  int best_score = 0;
+  std::vector<std::pair<int, unsigned int>> stopping_bounds;
+  while (result.iterations < parameters.max_iterations) {
+    // Samples are drawn serially so the PROSAC schedule and the result do not depend on the thread count
+    int batch = static_cast<int>(std::min<unsigned int>(batch_size, parameters.max_iterations - result.iterations));
+    for (int b = 0; b < batch; ++b) {
+      sampler.sample(rng, &samples[b * sample_size]);
+    }
+
+    const int score_to_beat = best_score;
+    cv::parallel_for_(cv::Range(0, batch), [&](const cv::Range &range) {
+      for (int b = range.start; b < range.end; ++b) {
+        scores[b] = 0;
+        if (estimate_model(parameters.model, points, &samples[b * sample_size], sample_size, hypotheses[b])) {
+          scores[b] = count_inliers(parameters.model, points, hypotheses[b], threshold2, score_to_beat);
+        }
+      }
+    });
+    result.iterations += batch;
+
+    bool improved = false;
+    for (int b = 0; b < batch; ++b) {
+      if (scores[b] > best_score) {
+        best_score = scores[b];
+        best_model = hypotheses[b];
+        improved = true;
+      }
+    }
+    if (improved) {
+      std::vector<int> inliers = find_inliers(parameters.model, points, best_model, threshold2);
+      stopping_bounds = prosac_stopping_bounds(inliers, num_points, sample_size, parameters.confidence, parameters.max_iterations);
+    }
+    if (std::any_of(stopping_bounds.begin(), stopping_bounds.end(), [&](const std::pair<int, unsigned int> &bound) { return sampler.samples_within(bound.first) >= bound.second; })) {
+      break;
+    }
+  }
+  if (best_score < sample_size) {
+    return result;
+  }
+
+  // Refit on all inliers of the best hypothesis and keep the refit if it does not lose support
+  std::vector<int> inliers = find_inliers(parameters.model, points, best_model, threshold2);
+  cv::Matx33d refined_model;
+  if (estimate_model(parameters.model, points, inliers.data(), static_cast<int>(inliers.size()), refined_model)) {
+    std::vector<int> refined_inliers = find_inliers(parameters.model, points, refined_model, threshold2);
+    if (refined_inliers.size() >= inliers.size()) {
+      best_model = refined_model;
+      inliers.swap(refined_inliers);
+    }
+  }
+
+  result.model = cv::Mat(best_model, true);
+  result.num_inliers = static_cast<unsigned int>(inliers.size());
+  for (int index : inliers) {
+    result.inlier_mask[order[index]] = 1;
+  }
+  return result;
+}
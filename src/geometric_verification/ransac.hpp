@@ -0,0 +1,47 @@
+#ifndef ransac_hpp
+#define ransac_hpp
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "../harris_corner_detector/harris.hpp"
+
+namespace ransac {
+  enum class Model {
+    FUNDAMENTAL, // normalized 8-point, scored with the Sampson error
+    HOMOGRAPHY   // normalized 4-point DLT, scored with the forward transfer error
+  };
+
+  struct Correspondence {
+    cv::Point2d left;
+    cv::Point2d right;
+    // Higher is better; PROSAC draws its first hypotheses from the best scored matches
+    double score;
+  };
+
+  struct Parameters {
+    Model model = Model::FUNDAMENTAL;
+    double inlier_threshold = 1.0; // pixels
+    double confidence = 0.999;
+    unsigned int max_iterations = 10000;
+    // Number of hypotheses generated and scored together by each parallel batch
+    unsigned int batch_size = 64;
+  };
+
+  struct Result {
+    cv::Mat model; // 3x3 CV_64F, empty if no model could be estimated
+    std::vector<uchar> inlier_mask; // same order as the input correspondences
+    unsigned int num_inliers = 0;
+    unsigned int iterations = 0;
+  };
+
+  // Pairs left[i] with right[i]; scores[i] is their match similarity, e.g. descriptor correlation.
+  // Returns no correspondences if the three vectors differ in size.
+  std::vector<Correspondence> make_correspondences(const std::vector<harris::InterestPoint> &left, const std::vector<harris::InterestPoint> &right, const std::vector<double> &scores);
+  // Reads the x1, y1, x2, y2 vectors from the ground truth .mat files under images/
+  std::vector<Correspondence> load_ground_truth(const std::string &mat_path);
+  Result verify(const std::vector<Correspondence> &correspondences, const Parameters &parameters);
+};
+
+#endif /* ransac_hpp */